@@ -0,0 +1,216 @@
+#include <mpi.h>
+#include <iostream>
+#include <cstdlib>
+#include <string>
+
+#include "../include/mpiworker/mpiworker.hpp"
+
+/*! \russian Микробенчмарк коллективных операций в стиле OSU micro-benchmarks.
+ * Для каждой операции (scatterv, gatherv, allGatherv, reduce, allReduce и setNElems), режима setMode(0)/setMode(1),
+ * типа элементов и числа элементов измеряется время вызова метода mpiworker::MPIWorker и эквивалентного вызова MPI C API.
+ * Результат выводится нулевым узлом в формате CSV:
+ * \code op,impl,type,mode,nNodes,nElems,bytes,iters,avg_us,min_us,max_us \endcode
+ * где avg_us, min_us, max_us --- среднее, минимальное и максимальное по узлам время одного вызова в микросекундах.
+ * Число узлов задается при запуске, например \code mpirun -np 4 ./bench_collectives 1048576 1000 \endcode
+ * (первый аргумент --- максимальное число элементов, второй --- число итераций для малых сообщений).
+ */
+
+//! \~russian Соответствие типов C++ типам MPI.
+template <typename T> struct BenchType;
+
+template <> struct BenchType<int>
+{
+    static const char * name() { return "int"; }
+    static MPI::Datatype cxx() { return MPI::INT; }
+    static MPI_Datatype c() { return MPI_INT; }
+};
+
+template <> struct BenchType<float>
+{
+    static const char * name() { return "float"; }
+    static MPI::Datatype cxx() { return MPI::FLOAT; }
+    static MPI_Datatype c() { return MPI_FLOAT; }
+};
+
+template <> struct BenchType<double>
+{
+    static const char * name() { return "double"; }
+    static MPI::Datatype cxx() { return MPI::DOUBLE; }
+    static MPI_Datatype c() { return MPI_DOUBLE; }
+};
+
+
+//! \~russian Число итераций прогрева перед каждым замером.
+const int nWarmup = 10;
+
+//! \~russian Начиная с этого размера сообщения (в байтах) число итераций уменьшается в 10 раз.
+const long largeMessageBytes = 8192;
+
+
+//! \~russian Возвращает среднее время одного вызова f() в микросекундах на текущем узле.
+template <typename F>
+double timeLoop( F f, int iters )
+{
+    for( int i = 0; i < nWarmup; ++i ) f();
+
+    MPI_Barrier( MPI_COMM_WORLD );
+
+    double t0 = MPI_Wtime();
+    for( int i = 0; i < iters; ++i ) f();
+    return ( MPI_Wtime() - t0 ) * 1e6 / iters;
+}
+
+
+//! \~russian Собирает время со всех узлов и печатает строку CSV на нулевом узле.
+void report
+(
+    const std::string & op,
+    const std::string & impl,
+    const std::string & type,
+    int mode,
+    int nNodes,
+    long nElems,
+    long bytes,
+    int iters,
+    double t
+)
+{
+    double tMin = 0, tMax = 0, tSum = 0;
+
+    MPI_Reduce( &t, &tMin, 1, MPI_DOUBLE, MPI_MIN, 0, MPI_COMM_WORLD );
+    MPI_Reduce( &t, &tMax, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD );
+    MPI_Reduce( &t, &tSum, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD );
+
+    int rank = 0;
+    MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+
+    if( !rank )
+    {
+        std::cout << op << ',' << impl << ',' << type << ',' << mode << ',' << nNodes << ','
+                  << nElems << ',' << bytes << ',' << iters << ','
+                  << tSum / nNodes << ',' << tMin << ',' << tMax << std::endl;
+    }
+}
+
+
+//! \~russian Замеряет коллективные операции с данными типа T для всех размеров массива от 1 до maxElems.
+template <typename T>
+void benchType( mpiworker::MPIWorker & w, int mode, long maxElems, int itersSmall )
+{
+    const char * tName = BenchType<T>::name();
+    MPI::Datatype cxxType = BenchType<T>::cxx();
+    MPI_Datatype cType = BenchType<T>::c();
+
+    int nNodes = w.getNNodes();
+
+    for( long N = 1; N <= maxElems; N *= 4 )
+    {
+        long bytes = N * sizeof( T );
+        int iters = bytes < largeMessageBytes ? itersSmall : std::max( 1, itersSmall / 10 );
+
+        w.setNElems( N );
+        const std::vector<int> & counts = w.getCountsElemsPerNode();
+        const std::vector<int> & displs = w.getDisplsElemsPerNode();
+        int nPerNode = w.getNElemsPerNode();
+
+        std::vector<T> x( N, T( 1 ) ), xPerNode( nPerNode, T( 1 ) ), y( N ), yRes( N );
+
+        double t = 0;
+
+        // scatterv
+
+        t = timeLoop( [&]{ MPI_Scatterv( x.data(), counts.data(), displs.data(), cType, xPerNode.data(), nPerNode, cType, 0, MPI_COMM_WORLD ); }, iters );
+        report( "scatterv", "mpi", tName, mode, nNodes, N, bytes, iters, t );
+
+        t = timeLoop( [&]{ w.scatterv<T>( x, xPerNode, cxxType ); }, iters );
+        report( "scatterv", "mpiworker", tName, mode, nNodes, N, bytes, iters, t );
+
+        // gatherv
+
+        t = timeLoop( [&]{ MPI_Gatherv( xPerNode.data(), nPerNode, cType, y.data(), counts.data(), displs.data(), cType, 0, MPI_COMM_WORLD ); }, iters );
+        report( "gatherv", "mpi", tName, mode, nNodes, N, bytes, iters, t );
+
+        t = timeLoop( [&]{ w.gatherv<T>( xPerNode, y, cxxType ); }, iters );
+        report( "gatherv", "mpiworker", tName, mode, nNodes, N, bytes, iters, t );
+
+        // allGatherv
+
+        t = timeLoop( [&]{ MPI_Allgatherv( xPerNode.data(), nPerNode, cType, y.data(), counts.data(), displs.data(), cType, MPI_COMM_WORLD ); }, iters );
+        report( "allGatherv", "mpi", tName, mode, nNodes, N, bytes, iters, t );
+
+        t = timeLoop( [&]{ w.allGatherv<T>( xPerNode, y, cxxType ); }, iters );
+        report( "allGatherv", "mpiworker", tName, mode, nNodes, N, bytes, iters, t );
+
+        // reduce
+
+        t = timeLoop( [&]{ MPI_Reduce( x.data(), yRes.data(), N, cType, MPI_SUM, 0, MPI_COMM_WORLD ); }, iters );
+        report( "reduce", "mpi", tName, mode, nNodes, N, bytes, iters, t );
+
+        t = timeLoop( [&]{ w.reduce<T>( x, yRes, cxxType, MPI::SUM ); }, iters );
+        report( "reduce", "mpiworker", tName, mode, nNodes, N, bytes, iters, t );
+
+        // allReduce
+
+        t = timeLoop( [&]{ MPI_Allreduce( x.data(), yRes.data(), N, cType, MPI_SUM, MPI_COMM_WORLD ); }, iters );
+        report( "allReduce", "mpi", tName, mode, nNodes, N, bytes, iters, t );
+
+        t = timeLoop( [&]{ w.allReduce<T>( x, yRes, cxxType, MPI::SUM ); }, iters );
+        report( "allReduce", "mpiworker", tName, mode, nNodes, N, bytes, iters, t );
+    }
+}
+
+
+//! \~russian Замеряет стоимость перераспределения элементов по узлам методом setNElems.
+void benchSetNElems( mpiworker::MPIWorker & w, int mode, long maxElems, int iters )
+{
+    int rank = w.getRankNode();
+    int nNodes = w.getNNodes();
+
+    std::vector<int> counts( nNodes ), displs( nNodes );
+
+    for( long N = 1; N <= maxElems; N *= 4 )
+    {
+        double t = 0;
+
+        t = timeLoop
+        (
+            [&]
+            {
+                if( !rank ) calculatePortions( static_cast<int>( N ), counts.begin(), counts.end(), displs.begin(), displs.end(), mode );
+                MPI_Bcast( counts.data(), nNodes, MPI_INT, 0, MPI_COMM_WORLD );
+                MPI_Bcast( displs.data(), nNodes, MPI_INT, 0, MPI_COMM_WORLD );
+            },
+            iters
+        );
+        report( "setNElems", "mpi", "-", mode, nNodes, N, 0, iters, t );
+
+        t = timeLoop( [&]{ w.setNElems( N ); }, iters );
+        report( "setNElems", "mpiworker", "-", mode, nNodes, N, 0, iters, t );
+    }
+}
+
+
+int main( int argc, char ** argv )
+{
+    long maxElems = argc > 1 ? std::atol( argv[1] ) : 1 << 20;
+    int iters = argc > 2 ? std::atoi( argv[2] ) : 1000;
+
+    mpiworker::MPIWorker w;
+
+    if( !w.getRankNode() )
+    {
+        std::cout << "op,impl,type,mode,nNodes,nElems,bytes,iters,avg_us,min_us,max_us" << std::endl;
+    }
+
+    for( short mode = 0; mode <= 1; ++mode )
+    {
+        w.setMode( mode );
+
+        benchSetNElems( w, mode, maxElems, iters );
+        benchType<int>( w, mode, maxElems, iters );
+        benchType<float>( w, mode, maxElems, iters );
+        benchType<double>( w, mode, maxElems, iters );
+    }
+
+    return 0;
+}
@@ -0,0 +1,144 @@
+#define MPIWORKER_NO_MPI
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <chrono>
+
+#include "../include/mpiworker/mpiworker.hpp"
+
+/*! \russian Микробенчмарк коллективных операций mpiworker::MPIWorker в потоковом режиме (mpiworker::runThreads), собирается без MPI.
+ * Формат вывода совпадает с bench_collectives (impl = threads), что позволяет сравнивать результаты двух режимов:
+ * \code op,impl,type,mode,nNodes,nElems,bytes,iters,avg_us,min_us,max_us \endcode
+ * Запуск: \code ./bench_threads 4 1048576 1000 \endcode
+ * (число потоков, максимальное число элементов, число итераций для малых сообщений).
+ */
+
+//! \~russian Соответствие типов C++ типам MPI.
+template <typename T> struct BenchType;
+
+template <> struct BenchType<int>
+{
+    static const char * name() { return "int"; }
+    static MPI::Datatype cxx() { return MPI::INT; }
+};
+
+template <> struct BenchType<float>
+{
+    static const char * name() { return "float"; }
+    static MPI::Datatype cxx() { return MPI::FLOAT; }
+};
+
+template <> struct BenchType<double>
+{
+    static const char * name() { return "double"; }
+    static MPI::Datatype cxx() { return MPI::DOUBLE; }
+};
+
+
+//! \~russian Число итераций прогрева перед каждым замером.
+const int nWarmup = 10;
+
+//! \~russian Начиная с этого размера сообщения (в байтах) число итераций уменьшается в 10 раз.
+const long largeMessageBytes = 8192;
+
+//! \~russian Время одного вызова на каждом из узлов.
+std::vector<double> times;
+
+
+//! \~russian Барьер для всех узлов-потоков.
+void barrier()
+{
+    mpiworker::threadContext().comm->barrier();
+}
+
+
+//! \~russian Замеряет среднее время одного вызова f() в микросекундах и печатает строку CSV на нулевом узле.
+template <typename F>
+void timeLoop( mpiworker::MPIWorker & w, F f, int iters, const std::string & op, const std::string & type, int mode, long nElems, long bytes )
+{
+    for( int i = 0; i < nWarmup; ++i ) f();
+
+    barrier();
+
+    auto t0 = std::chrono::steady_clock::now();
+    for( int i = 0; i < iters; ++i ) f();
+    std::chrono::duration<double, std::micro> dt = std::chrono::steady_clock::now() - t0;
+
+    times[w.getRankNode()] = dt.count() / iters;
+    barrier();
+
+    if( !w.getRankNode() )
+    {
+        double tSum = 0;
+        for( double t: times ) tSum += t;
+
+        std::cout << op << ",threads," << type << ',' << mode << ',' << w.getNNodes() << ','
+                  << nElems << ',' << bytes << ',' << iters << ','
+                  << tSum / times.size() << ','
+                  << *std::min_element( times.begin(), times.end() ) << ','
+                  << *std::max_element( times.begin(), times.end() ) << std::endl;
+    }
+    barrier();
+}
+
+
+//! \~russian Замеряет коллективные операции с данными типа T для всех размеров массива от 1 до maxElems.
+template <typename T>
+void benchType( mpiworker::MPIWorker & w, int mode, long maxElems, int itersSmall )
+{
+    const char * tName = BenchType<T>::name();
+    MPI::Datatype type = BenchType<T>::cxx();
+
+    for( long N = 1; N <= maxElems; N *= 4 )
+    {
+        long bytes = N * sizeof( T );
+        int iters = bytes < largeMessageBytes ? itersSmall : std::max( 1, itersSmall / 10 );
+
+        w.setNElems( N );
+
+        std::vector<T> x( N, T( 1 ) ), xPerNode( w.getNElemsPerNode(), T( 1 ) ), y( N ), yRes( N );
+
+        timeLoop( w, [&]{ w.scatterv<T>( x, xPerNode, type ); }, iters, "scatterv", tName, mode, N, bytes );
+        timeLoop( w, [&]{ w.gatherv<T>( xPerNode, y, type ); }, iters, "gatherv", tName, mode, N, bytes );
+        timeLoop( w, [&]{ w.allGatherv<T>( xPerNode, y, type ); }, iters, "allGatherv", tName, mode, N, bytes );
+        timeLoop( w, [&]{ w.reduce<T>( x, yRes, type, MPI::SUM ); }, iters, "reduce", tName, mode, N, bytes );
+        timeLoop( w, [&]{ w.allReduce<T>( x, yRes, type, MPI::SUM ); }, iters, "allReduce", tName, mode, N, bytes );
+    }
+}
+
+
+int main( int argc, char ** argv )
+{
+    int nThreads = argc > 1 ? std::atoi( argv[1] ) : 4;
+    long maxElems = argc > 2 ? std::atol( argv[2] ) : 1 << 20;
+    int iters = argc > 3 ? std::atoi( argv[3] ) : 1000;
+
+    times.resize( nThreads );
+
+    std::cout << "op,impl,type,mode,nNodes,nElems,bytes,iters,avg_us,min_us,max_us" << std::endl;
+
+    mpiworker::runThreads
+    (
+        nThreads,
+        [&]
+        {
+            mpiworker::MPIWorker w;
+
+            for( short mode = 0; mode <= 1; ++mode )
+            {
+                w.setMode( mode );
+
+                for( long N = 1; N <= maxElems; N *= 4 )
+                {
+                    timeLoop( w, [&]{ w.setNElems( N ); }, iters, "setNElems", "-", mode, N, 0 );
+                }
+
+                benchType<int>( w, mode, maxElems, iters );
+                benchType<float>( w, mode, maxElems, iters );
+                benchType<double>( w, mode, maxElems, iters );
+            }
+        }
+    );
+
+    return 0;
+}
@@ -0,0 +1,332 @@
+/** @addtogroup MPIWorker
+ * @{*/
+
+ /** @file */
+
+#ifndef CLASS_DISTRIBUTED_CSR_NDN_2016
+#define CLASS_DISTRIBUTED_CSR_NDN_2016
+
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+#include "mpiworker.hpp"
+
+namespace mpiworker
+{
+
+    /*! \brief \~russian Квадратная разреженная матрица в формате CSR, строки которой распределены по узлам так же, как элементы в mpiworker::MPIWorker.
+     *
+     * \~russian Каждый узел хранит свои строки (counts и displs объекта MPIWorker) с глобальными номерами столбцов.
+     * Вектор x распределен по узлам так же, как строки. В конструкторе один раз строится план обмена:
+     * какие элементы x нужны текущему узлу и у каких узлов их взять, а также какие свои элементы отправить соседям.
+     * Строки делятся на диагональный блок (столбцы текущего узла) и внедиагональный (столбцы соседей).
+     *
+     * \~russian Умножение spmv() передает только нужные соседям элементы неблокирующими операциями
+     * в собственной копии COMM_WORLD и, пока идет обмен, умножает диагональный блок (OpenMP). В потоковом режиме (mpiworker::runThreads)
+     * нужные элементы копируются напрямую из памяти соседних потоков.
+     * \code
+     *    mpiworker::MPIWorker w;
+     *    w.setMode(1);
+     *    w.setNElems(N);                                            // rows and x are split as counts/displs
+     *    mpiworker::DistributedCSR<double> A( w, rowPtr, cols, vals, MPI::DOUBLE );
+     *    A.spmv( xPerNode, yPerNode );                              // yPerNode = (A x) for the rows of this node
+     * \endcode
+     */
+    template <typename T>
+    class DistributedCSR
+    {
+        //! \~russian Число строк текущего узла.
+        int nRows_ { 0 };
+
+        //! \~russian Тип элементов для MPI.
+        MPI::Datatype MPIType_;
+
+        //! \~russian Коммуникатор потокового режима или nullptr.
+        ThreadComm * threadComm_ { nullptr };
+
+        //! \~russian Ранг узла.
+        int rankNode_ { 0 };
+
+        //! \~russian Диагональный блок: номера столбцов локальные.
+        std::vector<int> diagRowPtr_, diagCols_;
+        std::vector<T> diagVals_;
+
+        //! \~russian Внедиагональный блок: номера столбцов --- индексы в ghost_.
+        std::vector<int> offRowPtr_, offCols_;
+        std::vector<T> offVals_;
+
+        //! \~russian Значения x соседей, нужные текущему узлу.
+        std::vector<T> ghost_;
+
+        //! \~russian Владелец и локальный индекс у владельца для каждого элемента ghost_.
+        std::vector<int> ghostOwner_, ghostIndex_;
+
+        //! \~russian Узлы, от которых принимаются данные, и смещения их частей в ghost_ (recvOffsets_.size() == recvRanks_.size()+1).
+        std::vector<int> recvRanks_, recvOffsets_;
+
+        //! \~russian Узлы, которым отправляются данные, смещения их частей в sendBuf_ и локальные индексы отправляемых элементов x.
+        std::vector<int> sendRanks_, sendOffsets_, sendIndex_;
+
+        //! \~russian Буфер для отправки.
+        std::vector<T> sendBuf_;
+
+#ifndef MPIWORKER_NO_MPI
+        //! \~russian Копия COMM_WORLD для обменов матрицы. \details \~russian Сообщения приложения в COMM_WORLD не могут совпасть с сообщениями spmv().
+        MPI::Intracomm comm_ { MPI::COMM_NULL };
+
+        //! \~russian Запросы неблокирующего обмена: сначала приемы, затем отправки.
+        std::vector<MPI::Request> requests_;
+#endif
+
+        //! \~russian Меньшее число строк умножается без открытия параллельной области OpenMP.
+        static const int minRowsParallel = 1024;
+
+        //! \~russian Умножать строки параллельно (OpenMP). \details \~russian В потоковом режиме каждый узел уже является потоком, поэтому строки умножаются последовательно.
+        bool parallel_ { false };
+
+        //! \~russian y[i] (+)= сумма vals[j]*x[cols[j]] по строке i. \details \~russian При parallel строки обрабатываются параллельно (OpenMP), строка --- векторно.
+        static void multiply( const std::vector<int> & rowPtr, const std::vector<int> & cols, const std::vector<T> & vals, const T * x, T * y, int nRows, bool accumulate, bool parallel )
+        {
+            const int * rp = rowPtr.data();
+            const int * c = cols.data();
+            const T * v = vals.data();
+
+            #pragma omp parallel for schedule(static) if( parallel )
+            for( int i = 0; i < nRows; ++i )
+            {
+                T sum = accumulate ? y[i] : T( 0 );
+
+                #pragma omp simd reduction(+:sum)
+                for( int j = rp[i]; j < rp[i+1]; ++j ) sum += v[j] * x[c[j]];
+
+                y[i] = sum;
+            }
+        }
+
+    public:
+
+        /*! \~russian Конструктор. Коллективная операция: вызывается на всех узлах.
+         * Если хотя бы на одном узле массивы не соответствуют разбиению или номер столбца вне [0,N), std::invalid_argument бросается на всех узлах.
+         * \param[in] w Объект, задающий распределение строк (после setMode и setNElems).
+         * \param[in] rowPtr Начала строк текущего узла, размер w.getNElemsPerNode()+1.
+         * \param[in] cols Глобальные номера столбцов.
+         * \param[in] vals Значения.
+         * \param[in] MPIType Тип элементов.
+         */
+        DistributedCSR( const MPIWorker & w, const std::vector<int> & rowPtr, const std::vector<int> & cols, const std::vector<T> & vals, MPI::Datatype MPIType )
+            : nRows_( w.getNElemsPerNode() ), MPIType_( MPIType ), threadComm_( w.getThreadComm() ), rankNode_( w.getRankNode() )
+        {
+            const std::vector<int> & counts = w.getCountsElemsPerNode();
+            const std::vector<int> & displs = w.getDisplsElemsPerNode();
+            int nNodes = w.getNNodes();
+            int first = displs[rankNode_];
+            int nElems = displs.back() + counts.back();
+
+            parallel_ = !threadComm_ && nRows_ >= minRowsParallel;
+
+            // Validate on every node before any other collective call, otherwise one node would throw and the rest would hang.
+
+            int valid = rowPtr.size() == static_cast<size_t>( nRows_ + 1 ) && rowPtr.front() == 0 && cols.size() == vals.size();
+
+            for( int i = 0; valid && i < nRows_; ++i )
+            {
+                if( rowPtr[i] > rowPtr[i+1] || static_cast<size_t>( rowPtr[i+1] ) > cols.size() ) valid = 0;
+            }
+
+            for( int j = 0; valid && j < rowPtr.back(); ++j )
+            {
+                if( cols[j] < 0 || cols[j] >= nElems ) valid = 0;
+            }
+
+            int validAll = valid;
+            if( threadComm_ )
+            {
+                threadComm_->allReduce( rankNode_, &valid, &validAll, 1, ReduceOp::MIN );
+            }
+            else
+            {
+#ifndef MPIWORKER_NO_MPI
+                MPI::COMM_WORLD.Allreduce( &valid, &validAll, 1, MPI::INT, MPI::MIN );
+#endif
+            }
+
+            if( !validAll )
+            {
+                throw std::invalid_argument( "mpiworker: CSR arrays do not match the MPIWorker layout" );
+            }
+
+            // Remote columns: sorted and unique, hence grouped by owner in rank order.
+
+            std::vector<int> remote;
+            for( int j = 0; j < rowPtr.back(); ++j )
+            {
+                if( cols[j] < first || cols[j] >= first + nRows_ ) remote.push_back( cols[j] );
+            }
+            std::sort( remote.begin(), remote.end() );
+            remote.erase( std::unique( remote.begin(), remote.end() ), remote.end() );
+
+            int nGhosts = remote.size();
+            ghost_.resize( nGhosts );
+            ghostOwner_.resize( nGhosts );
+            ghostIndex_.resize( nGhosts );
+
+            std::vector<int> recvCounts( nNodes, 0 );
+            for( int g = 0; g < nGhosts; ++g )
+            {
+                int owner = std::upper_bound( displs.begin(), displs.end(), remote[g] ) - displs.begin() - 1;
+                ghostOwner_[g] = owner;
+                ghostIndex_[g] = remote[g] - displs[owner];
+                ++recvCounts[owner];
+            }
+
+            recvOffsets_.push_back( 0 );
+            for( int r = 0; r < nNodes; ++r )
+            {
+                if( !recvCounts[r] ) continue;
+                recvRanks_.push_back( r );
+                recvOffsets_.push_back( recvOffsets_.back() + recvCounts[r] );
+            }
+
+            // Split the rows into the diagonal and the off-diagonal blocks.
+
+            diagRowPtr_.assign( 1, 0 );
+            offRowPtr_.assign( 1, 0 );
+            for( int i = 0; i < nRows_; ++i )
+            {
+                for( int j = rowPtr[i]; j < rowPtr[i+1]; ++j )
+                {
+                    if( cols[j] >= first && cols[j] < first + nRows_ )
+                    {
+                        diagCols_.push_back( cols[j] - first );
+                        diagVals_.push_back( vals[j] );
+                    }
+                    else
+                    {
+                        offCols_.push_back( std::lower_bound( remote.begin(), remote.end(), cols[j] ) - remote.begin() );
+                        offVals_.push_back( vals[j] );
+                    }
+                }
+                diagRowPtr_.push_back( diagCols_.size() );
+                offRowPtr_.push_back( offCols_.size() );
+            }
+
+            // Threads read the remote entries directly, MPI needs to know what to send.
+
+            if( threadComm_ ) return;
+
+#ifndef MPIWORKER_NO_MPI
+            comm_ = MPI::COMM_WORLD.Dup();
+
+            std::vector<int> sendCounts( nNodes );
+            comm_.Alltoall( recvCounts.data(), 1, MPI::INT, sendCounts.data(), 1, MPI::INT );
+
+            std::vector<int> recvDispls( nNodes, 0 ), sendDispls( nNodes, 0 );
+            for( int r = 1; r < nNodes; ++r )
+            {
+                recvDispls[r] = recvDispls[r-1] + recvCounts[r-1];
+                sendDispls[r] = sendDispls[r-1] + sendCounts[r-1];
+            }
+
+            sendIndex_.resize( sendDispls.back() + sendCounts.back() );
+            comm_.Alltoallv
+            (
+                ghostIndex_.data(),
+                recvCounts.data(),
+                recvDispls.data(),
+                MPI::INT,
+                sendIndex_.data(),
+                sendCounts.data(),
+                sendDispls.data(),
+                MPI::INT
+            );
+
+            sendOffsets_.push_back( 0 );
+            for( int r = 0; r < nNodes; ++r )
+            {
+                if( !sendCounts[r] ) continue;
+                sendRanks_.push_back( r );
+                sendOffsets_.push_back( sendOffsets_.back() + sendCounts[r] );
+            }
+            sendBuf_.resize( sendIndex_.size() );
+            requests_.resize( recvRanks_.size() + sendRanks_.size() );
+#endif
+        }
+
+        DistributedCSR( const DistributedCSR & ) = delete;
+
+        DistributedCSR & operator=( const DistributedCSR & ) = delete;
+
+        //! \~russian Деструктор. Освобождает коммуникатор матрицы.
+        ~DistributedCSR()
+        {
+#ifndef MPIWORKER_NO_MPI
+            if( comm_ != MPI::COMM_NULL && !MPI::Is_finalized() ) comm_.Free();
+#endif
+        }
+
+        //! \~russian Возвращает число элементов x, получаемых от соседей.
+        int getNGhosts() const { return ghost_.size(); }
+
+        //! \~russian Возвращает число узлов, от которых получаются элементы x.
+        int getNNeighbours() const { return recvRanks_.size(); }
+
+        /*! \~russian Умножение матрицы на вектор. Коллективная операция: вызывается на всех узлах.
+         * \param[in] xPerNode Элементы x текущего узла. \param[out] yPerNode Элементы y = A x текущего узла.
+         * Размер xPerNode проверяется только на текущем узле: при ошибке остальные узлы не завершат обмен.
+         */
+        void spmv( const std::vector<T> & xPerNode, std::vector<T> & yPerNode )
+        {
+            if( xPerNode.size() != static_cast<size_t>( nRows_ ) )
+            {
+                throw std::invalid_argument( "mpiworker: vector size does not match the number of rows" );
+            }
+
+            if( yPerNode.size() != static_cast<size_t>( nRows_ ) ) yPerNode.resize( nRows_ );
+
+            if( threadComm_ )
+            {
+                threadComm_->neighbourExchange
+                (
+                    rankNode_,
+                    xPerNode.data(),
+                    ghostOwner_.data(),
+                    ghostIndex_.data(),
+                    ghost_.size(),
+                    ghost_.data(),
+                    [&]{ multiply( diagRowPtr_, diagCols_, diagVals_, xPerNode.data(), yPerNode.data(), nRows_, false, parallel_ ); }
+                );
+                multiply( offRowPtr_, offCols_, offVals_, ghost_.data(), yPerNode.data(), nRows_, true, parallel_ );
+                return;
+            }
+
+#ifndef MPIWORKER_NO_MPI
+            const int tag = 0;
+            size_t nRecv = recvRanks_.size();
+
+            for( size_t k = 0; k < nRecv; ++k )
+            {
+                requests_[k] = comm_.Irecv( ghost_.data() + recvOffsets_[k], recvOffsets_[k+1] - recvOffsets_[k], MPIType_, recvRanks_[k], tag );
+            }
+
+            for( size_t j = 0; j < sendIndex_.size(); ++j ) sendBuf_[j] = xPerNode[sendIndex_[j]];
+
+            for( size_t k = 0; k < sendRanks_.size(); ++k )
+            {
+                requests_[nRecv + k] = comm_.Isend( sendBuf_.data() + sendOffsets_[k], sendOffsets_[k+1] - sendOffsets_[k], MPIType_, sendRanks_[k], tag );
+            }
+
+            multiply( diagRowPtr_, diagCols_, diagVals_, xPerNode.data(), yPerNode.data(), nRows_, false, parallel_ );
+
+            MPI::Request::Waitall( requests_.size(), requests_.data() );
+
+            multiply( offRowPtr_, offCols_, offVals_, ghost_.data(), yPerNode.data(), nRows_, true, parallel_ );
+#endif
+        }
+    };
+
+} // namespace mpiworker
+
+#endif
+
+/*@}*/
@@ -115,12 +115,16 @@
 #include <vector>
 #include <iterator>
 #include <algorithm>
+#include <iostream>
+#include <stdexcept>
 
 #include "tools_for_parallel.hpp"
+#include "thread_comm.hpp"
 
 namespace mpiworker
 {
     
+#ifndef MPIWORKER_NO_MPI
     /*! \brief \~russian Создает и удаляет коммуникатор MPI::COMM_WORLD.
      *  \~russian Реализован как Singleton Meyers. Начиная с С++11 потокобезобасен [ISO N3337, 6.7.4].
      */ 
@@ -157,6 +161,7 @@ namespace mpiworker
         //! Возвращает число узлов.
         int getNNodes() const  { return nNodes_; }
     };
+#endif
     
     
     /*! \brief \~russian Содержит методы, выполняющие разделение и сборку массивов в MPI-приложении.
@@ -167,11 +172,14 @@ namespace mpiworker
      * - все узлы выполняют вычисления при setMode(1).
      *
      *   \~russian Предлагает упрощенный синтаксис вызова некоторых коллективных операций из стандарта MPI.
+     *
+     *   \~russian Объект, созданный внутри mpiworker::runThreads (или mpiworker::run при заданной MPIWORKER_THREADS),
+     *   выполняет те же операции над узлами-потоками одного процесса через mpiworker::ThreadComm.
      */
     class MPIWorker
     {
-        //! \~russian Ссылка на 
-        MPIInit& comm = MPIInit::instance();
+        //! \~russian Коммуникатор потокового режима. \details \~russian nullptr при работе через MPI.
+        ThreadComm * threadComm_ { nullptr };
     
         //! \~russian Общее число обрабатываемых элементов. \details \~russian Длина разрезаемого или собираемого массива.
         int nElems_ { 0 };
@@ -197,6 +205,28 @@ namespace mpiworker
         //! \~russian Выполняет расчет нагрузки для узлов.
         void calculate()
         {
+            if( threadComm_ )
+            {
+                // as with MPI, the layout is defined by the zero node
+                struct { int nElems; short mode; } layout { nElems_, mode_ };
+                threadComm_->bcast( rankNode_, layout );
+                nElems_ = layout.nElems;
+                mode_ = layout.mode;
+
+                calculatePortions
+                (
+                    nElems_,
+                    countsElemsPerNode_.begin(),
+                    countsElemsPerNode_.end(),
+                    displsElemsPerNode_.begin(),
+                    displsElemsPerNode_.end(),
+                    mode_
+                );
+                nElemsPerNode_ = countsElemsPerNode_[rankNode_];
+                return;
+            }
+
+#ifndef MPIWORKER_NO_MPI
             if( !rankNode_ )
             {
                 calculatePortions
@@ -227,13 +257,33 @@ namespace mpiworker
             );
     
             nElemsPerNode_ = countsElemsPerNode_[rankNode_];
+#endif
         }
     
     public:
     
-        //! \~russian Конструктор.
-        MPIWorker() : rankNode_( comm.getRankNode() ), nNodes_( comm.getNNodes() )
+        //! \~russian Конструктор. \details \~russian Внутри mpiworker::runThreads узлами являются потоки, иначе --- процессы MPI::COMM_WORLD.
+        MPIWorker()
         {
+            const ThreadContext & context = threadContext();
+
+            if( context.comm )
+            {
+                threadComm_ = context.comm;
+                rankNode_ = context.rank;
+                nNodes_ = context.comm->getNNodes();
+            }
+            else
+            {
+#ifdef MPIWORKER_NO_MPI
+                throw std::logic_error( "mpiworker: built without MPI, create MPIWorker inside mpiworker::runThreads" );
+#else
+                MPIInit & comm = MPIInit::instance();
+                rankNode_ = comm.getRankNode();
+                nNodes_ = comm.getNNodes();
+#endif
+            }
+
             countsElemsPerNode_.resize( nNodes_ );
             displsElemsPerNode_.resize( nNodes_ );
         }
@@ -267,13 +317,29 @@ namespace mpiworker
    
         //! \~russian Возвращает число элементов, которые должны быть обработаны на текущем узле
         int getNElemsPerNode() const { return nElemsPerNode_; }
-    
+
+        //! \~russian Возвращает число элементов для каждого из узлов.
+        const std::vector<int> & getCountsElemsPerNode() const { return countsElemsPerNode_; }
+
+        //! \~russian Возвращает смещения элементов в общем массиве для каждого из узлов.
+        const std::vector<int> & getDisplsElemsPerNode() const { return displsElemsPerNode_; }
+
+        //! \~russian Возвращает коммуникатор потокового режима или nullptr при работе через MPI.
+        ThreadComm * getThreadComm() const { return threadComm_; }
+
         //! \~russian Разделение элементов массива на приблизительно равные части. \details \~russian \param[in] array Исходный массив со всеми элементами. \param[out] arrayPerNode Выходной массив с элементами для текущего узла. \param[in] MPIType Тип элементов. 
         template <typename T>
         void scatterv( const std::vector<T> & array, std::vector<T> & arrayPerNode,  MPI::Datatype MPIType ) 
         {
             if( arrayPerNode.size() != nElemsPerNode_ ) arrayPerNode.resize( nElemsPerNode_ );
-    
+
+            if( threadComm_ )
+            {
+                threadComm_->scatterv( rankNode_, array.data(), countsElemsPerNode_.data(), displsElemsPerNode_.data(), arrayPerNode.data() );
+                return;
+            }
+
+#ifndef MPIWORKER_NO_MPI
             MPI::COMM_WORLD.Scatterv
             (
                 array.data(), 
@@ -285,6 +351,7 @@ namespace mpiworker
                 MPIType, 
                 0 
             );
+#endif
         }
     
     
@@ -295,6 +362,13 @@ namespace mpiworker
         {
             if( array.size() != nElems_ ) array.resize( nElems_ );
 
+            if( threadComm_ )
+            {
+                threadComm_->allGatherv( rankNode_, arrayPerNode.data(), countsElemsPerNode_.data(), displsElemsPerNode_.data(), array.data() );
+                return;
+            }
+
+#ifndef MPIWORKER_NO_MPI
             MPI::COMM_WORLD.Allgatherv
             (
                 arrayPerNode.data(),
@@ -305,6 +379,7 @@ namespace mpiworker
                 displsElemsPerNode_.data(),
                 MPIType
             );
+#endif
         }
     
     
@@ -314,6 +389,13 @@ namespace mpiworker
         {
             if( array.size() != nElems_ && !rankNode_ ) array.resize( nElems_ );
 
+            if( threadComm_ )
+            {
+                threadComm_->gatherv( rankNode_, arrayPerNode.data(), countsElemsPerNode_.data(), displsElemsPerNode_.data(), array.data() );
+                return;
+            }
+
+#ifndef MPIWORKER_NO_MPI
             MPI::COMM_WORLD.Gatherv
             (
                 arrayPerNode.data(),
@@ -325,12 +407,21 @@ namespace mpiworker
                 MPIType,
                 0
             );
+#endif
         }
     
         //! \~russian Рассылает значение скалярной переменной с нулевого узла на все остальные.
         template <typename T>void bcast( T & var, MPI::Datatype MPIType )
         {
+            if( threadComm_ )
+            {
+                threadComm_->bcast( rankNode_, var );
+                return;
+            }
+
+#ifndef MPIWORKER_NO_MPI
             MPI::COMM_WORLD.Bcast( &var, 1, MPIType, 0 );
+#endif
         }
     
         //! \~russian Выполняет редукцию со сбором результата на нулевом узле
@@ -338,6 +429,13 @@ namespace mpiworker
         {
             if( arrayRes.size() != nElems_ && !rankNode_ ) arrayRes.resize( nElems_ );
 
+            if( threadComm_ )
+            {
+                threadComm_->reduce( rankNode_, arrayPart.data(), arrayRes.data(), arrayPart.size(), toReduceOp( MPIOp ) );
+                return;
+            }
+
+#ifndef MPIWORKER_NO_MPI
             MPI::COMM_WORLD.Reduce
             ( 
                 arrayPart.data(), 
@@ -347,6 +445,7 @@ namespace mpiworker
                 MPIOp, 
                 0 
             );
+#endif
         }
     
         //! \~russian Выполняет редукцию с сохранением результата на всех узлах
@@ -354,6 +453,13 @@ namespace mpiworker
         {
             if( arrayRes.size() != nElems_ ) arrayRes.resize( nElems_ );
 
+            if( threadComm_ )
+            {
+                threadComm_->allReduce( rankNode_, arrayPart.data(), arrayRes.data(), arrayRes.size(), toReduceOp( MPIOp ) );
+                return;
+            }
+
+#ifndef MPIWORKER_NO_MPI
             MPI::COMM_WORLD.Allreduce
             ( 
                 arrayPart.data(), 
@@ -362,6 +468,7 @@ namespace mpiworker
                 MPIType, 
                 MPIOp 
             );
+#endif
         }
     
         //! \~russian Печать значений, хранимых в полях.
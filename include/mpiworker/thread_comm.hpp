@@ -0,0 +1,351 @@
+/** @addtogroup MPIWorker
+ * @{*/
+
+ /** @file */
+
+#ifndef CLASS_THREAD_COMM_NDN_2016
+#define CLASS_THREAD_COMM_NDN_2016
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <stdexcept>
+#include <functional>
+#include <algorithm>
+#include <cstdlib>
+
+
+#ifdef MPIWORKER_NO_MPI
+/*! \brief \~russian Заглушки типов MPI для сборки без библиотеки MPI (-DMPIWORKER_NO_MPI).
+ * \~russian Позволяют использовать прежний синтаксис вызовов, например w.scatterv<float>(x,xPerNode,MPI::FLOAT).
+ * Тип элементов определяется параметром шаблона, поэтому Datatype служит только меткой.
+ */
+namespace MPI
+{
+    struct Datatype { int id; };
+
+    struct Op { int id; };
+
+    static const Datatype CHAR { 0 }, SHORT { 1 }, INT { 2 }, LONG { 3 },
+                          UNSIGNED { 4 }, UNSIGNED_LONG { 5 }, FLOAT { 6 }, DOUBLE { 7 };
+
+    static const Op SUM { 0 }, PROD { 1 }, MAX { 2 }, MIN { 3 };
+}
+#endif
+
+
+namespace mpiworker
+{
+
+    //! \~russian Операции редукции, поддерживаемые потоковым режимом.
+    enum class ReduceOp { SUM, PROD, MAX, MIN };
+
+    //! \~russian Преобразует MPI::Op в ReduceOp. \details \~russian Для прочих операций бросает std::invalid_argument.
+    inline ReduceOp toReduceOp( const MPI::Op & MPIOp )
+    {
+#ifdef MPIWORKER_NO_MPI
+        if( MPIOp.id >= 0 && MPIOp.id <= 3 ) return static_cast<ReduceOp>( MPIOp.id );
+#else
+        MPI_Op op = MPIOp;
+        if( op == MPI_SUM ) return ReduceOp::SUM;
+        if( op == MPI_PROD ) return ReduceOp::PROD;
+        if( op == MPI_MAX ) return ReduceOp::MAX;
+        if( op == MPI_MIN ) return ReduceOp::MIN;
+#endif
+        throw std::invalid_argument( "mpiworker: reduction is not supported by the thread backend" );
+    }
+
+
+    /*! \brief \~russian Коммуникатор для узлов, работающих как потоки одного процесса.
+     *
+     * \~russian Узлы обмениваются указателями на свои массивы и синхронизируются барьером,
+     * после чего каждый поток копирует нужные ему данные напрямую из памяти других потоков.
+     * Каждая коллективная операция завершается барьером, поэтому буферы можно изменять сразу после возврата.
+     */
+    class ThreadComm
+    {
+        //! \~russian Число узлов (потоков).
+        int nNodes_;
+
+        //! \~russian Указатели на входные массивы узлов.
+        std::vector<const void*> src_;
+
+        //! \~russian Указатели на выходные массивы узлов.
+        std::vector<void*> dst_;
+
+        std::mutex mutex_;
+
+        std::condition_variable cv_;
+
+        //! \~russian Число потоков, ожидающих на барьере.
+        int nWaiting_ { 0 };
+
+        //! \~russian Номер поколения барьера.
+        unsigned long generation_ { 0 };
+
+        //! \~russian Признак аварийного завершения одного из потоков.
+        bool aborted_ { false };
+
+        //! \~russian Границы части [begin,end) из n элементов, обрабатываемой узлом rank.
+        void chunk( int rank, int n, int & begin, int & end ) const
+        {
+            begin = static_cast<int>( static_cast<long long>( n ) * rank / nNodes_ );
+            end = static_cast<int>( static_cast<long long>( n ) * ( rank + 1 ) / nNodes_ );
+        }
+
+        //! \~russian Поэлементная редукция входных массивов всех узлов на отрезке [begin,end) в res.
+        template <typename T, typename F>
+        void reduceRange( int begin, int end, T * res, F f ) const
+        {
+            const T * first = static_cast<const T*>( src_[0] );
+            std::copy( first + begin, first + end, res + begin );
+
+            for( int r = 1; r < nNodes_; ++r )
+            {
+                const T * part = static_cast<const T*>( src_[r] );
+                for( int i = begin; i < end; ++i ) res[i] = f( res[i], part[i] );
+            }
+        }
+
+        template <typename T>
+        void reduceRange( int begin, int end, T * res, ReduceOp op ) const
+        {
+            switch( op )
+            {
+                case ReduceOp::SUM:  reduceRange( begin, end, res, std::plus<T>() ); break;
+                case ReduceOp::PROD: reduceRange( begin, end, res, std::multiplies<T>() ); break;
+                case ReduceOp::MAX:  reduceRange( begin, end, res, []( const T & a, const T & b ){ return std::max( a, b ); } ); break;
+                case ReduceOp::MIN:  reduceRange( begin, end, res, []( const T & a, const T & b ){ return std::min( a, b ); } ); break;
+            }
+        }
+
+    public:
+
+        //! \~russian Конструктор. \param[in] nNodes Число узлов (потоков).
+        explicit ThreadComm( int nNodes ) : nNodes_( nNodes ), src_( nNodes, nullptr ), dst_( nNodes, nullptr ) {}
+
+        ThreadComm( const ThreadComm & ) = delete;
+
+        ThreadComm & operator=( const ThreadComm & ) = delete;
+
+        //! \~russian Возвращает число узлов.
+        int getNNodes() const { return nNodes_; }
+
+        //! \~russian Барьер для всех узлов. \details \~russian Если один из потоков завершился с исключением, бросает std::runtime_error.
+        void barrier()
+        {
+            std::unique_lock<std::mutex> lock( mutex_ );
+
+            if( aborted_ ) throw std::runtime_error( "mpiworker: thread backend aborted" );
+
+            unsigned long generation = generation_;
+
+            if( ++nWaiting_ == nNodes_ )
+            {
+                nWaiting_ = 0;
+                ++generation_;
+                cv_.notify_all();
+                return;
+            }
+
+            cv_.wait( lock, [&]{ return generation_ != generation || aborted_; } );
+
+            if( generation_ == generation ) throw std::runtime_error( "mpiworker: thread backend aborted" );
+        }
+
+        //! \~russian Снимает все потоки с барьера после аварийного завершения одного из них.
+        void abort()
+        {
+            std::lock_guard<std::mutex> lock( mutex_ );
+            aborted_ = true;
+            cv_.notify_all();
+        }
+
+        //! \~russian Аналог MPI_Scatterv с корнем в нулевом узле.
+        template <typename T>
+        void scatterv( int rank, const T * array, const int * counts, const int * displs, T * arrayPerNode )
+        {
+            if( !rank ) src_[0] = array;
+            barrier();
+
+            const T * from = static_cast<const T*>( src_[0] ) + displs[rank];
+            std::copy( from, from + counts[rank], arrayPerNode );
+            barrier();
+        }
+
+        //! \~russian Аналог MPI_Gatherv с корнем в нулевом узле.
+        template <typename T>
+        void gatherv( int rank, const T * arrayPerNode, const int * counts, const int * displs, T * array )
+        {
+            if( !rank ) dst_[0] = array;
+            barrier();
+
+            std::copy( arrayPerNode, arrayPerNode + counts[rank], static_cast<T*>( dst_[0] ) + displs[rank] );
+            barrier();
+        }
+
+        //! \~russian Аналог MPI_Allgatherv.
+        template <typename T>
+        void allGatherv( int rank, const T * arrayPerNode, const int * counts, const int * displs, T * array )
+        {
+            src_[rank] = arrayPerNode;
+            barrier();
+
+            for( int r = 0; r < nNodes_; ++r )
+            {
+                const T * from = static_cast<const T*>( src_[r] );
+                std::copy( from, from + counts[r], array + displs[r] );
+            }
+            barrier();
+        }
+
+        //! \~russian Аналог MPI_Bcast одного значения с нулевого узла.
+        template <typename T>
+        void bcast( int rank, T & var )
+        {
+            if( !rank ) src_[0] = &var;
+            barrier();
+
+            if( rank ) var = *static_cast<const T*>( src_[0] );
+            barrier();
+        }
+
+        //! \~russian Аналог MPI_Reduce со сбором результата на нулевом узле. \details \~russian Каждый узел редуцирует свою часть результата.
+        template <typename T>
+        void reduce( int rank, const T * arrayPart, T * arrayRes, int n, ReduceOp op )
+        {
+            src_[rank] = arrayPart;
+            if( !rank ) dst_[0] = arrayRes;
+            barrier();
+
+            int begin, end;
+            chunk( rank, n, begin, end );
+            reduceRange( begin, end, static_cast<T*>( dst_[0] ), op );
+            barrier();
+        }
+
+        //! \~russian Аналог MPI_Allreduce. \details \~russian Каждый узел редуцирует свою часть результата, затем копирует остальные части у других узлов.
+        template <typename T>
+        void allReduce( int rank, const T * arrayPart, T * arrayRes, int n, ReduceOp op )
+        {
+            src_[rank] = arrayPart;
+            dst_[rank] = arrayRes;
+            barrier();
+
+            int begin, end;
+            chunk( rank, n, begin, end );
+            reduceRange( begin, end, arrayRes, op );
+            barrier();
+
+            for( int r = 0; r < nNodes_; ++r )
+            {
+                if( r == rank ) continue;
+                chunk( r, n, begin, end );
+                const T * from = static_cast<const T*>( dst_[r] );
+                std::copy( from + begin, from + end, arrayRes + begin );
+            }
+            barrier();
+        }
+
+        /*! \~russian Обмен с соседями по заранее построенному плану. \details \~russian Каждый узел публикует свой массив array,
+         * затем копирует n нужных ему элементов ghost[i] = array узла owners[i] с индексом indices[i]
+         * и, пока остальные узлы делают то же самое, выполняет overlap().
+         */
+        template <typename T, typename F>
+        void neighbourExchange( int rank, const T * array, const int * owners, const int * indices, int n, T * ghost, F overlap )
+        {
+            src_[rank] = array;
+            barrier();
+
+            for( int i = 0; i < n; ++i ) ghost[i] = static_cast<const T*>( src_[owners[i]] )[indices[i]];
+            overlap();
+            barrier();
+        }
+    };
+
+
+    //! \~russian Коммуникатор и ранг текущего потока. \details \~russian comm == nullptr вне mpiworker::runThreads.
+    struct ThreadContext
+    {
+        ThreadComm * comm;
+        int rank;
+    };
+
+    //! \~russian Возвращает контекст текущего потока.
+    inline ThreadContext & threadContext()
+    {
+        static thread_local ThreadContext context { nullptr, 0 };
+        return context;
+    }
+
+
+    /*! \brief \~russian Запускает f на nNodes потоках, каждый из которых является узлом со своим рангом.
+     * \~russian Объекты mpiworker::MPIWorker, созданные внутри f, работают через mpiworker::ThreadComm, а не через MPI.
+     * Исключение, брошенное в одном из потоков, снимает остальные с барьеров и пробрасывается вызывающему.
+     */
+    template <typename F>
+    void runThreads( int nNodes, F f )
+    {
+        if( nNodes < 1 ) throw std::invalid_argument( "mpiworker: number of threads must be positive" );
+
+        ThreadComm comm( nNodes );
+        std::exception_ptr error;
+        std::mutex errorMutex;
+        std::vector<std::thread> threads;
+
+        for( int rank = 0; rank < nNodes; ++rank )
+        {
+            threads.emplace_back
+            (
+                [&, rank]
+                {
+                    threadContext() = ThreadContext { &comm, rank };
+                    try
+                    {
+                        f();
+                    }
+                    catch( ... )
+                    {
+                        {
+                            std::lock_guard<std::mutex> lock( errorMutex );
+                            if( !error ) error = std::current_exception();
+                        }
+                        comm.abort();
+                    }
+                    threadContext() = ThreadContext { nullptr, 0 };
+                }
+            );
+        }
+
+        for( auto & t: threads ) t.join();
+
+        if( error ) std::rethrow_exception( error );
+    }
+
+
+    /*! \brief \~russian Выбирает режим работы во время выполнения.
+     * \~russian Если задана переменная окружения MPIWORKER_THREADS=N, запускает f на N потоках (mpiworker::runThreads),
+     * иначе вызывает f в текущем MPI-процессе. При сборке с -DMPIWORKER_NO_MPI по умолчанию используется
+     * std::thread::hardware_concurrency() потоков.
+     */
+    template <typename F>
+    void run( F f )
+    {
+        const char * env = std::getenv( "MPIWORKER_THREADS" );
+        int nThreads = env ? std::atoi( env ) : 0;
+
+#ifdef MPIWORKER_NO_MPI
+        if( nThreads <= 0 ) nThreads = std::max( 1u, std::thread::hardware_concurrency() );
+#endif
+
+        if( nThreads > 0 ) runThreads( nThreads, f );
+        else f();
+    }
+
+} // namespace mpiworker
+
+#endif
+
+/*@}*/
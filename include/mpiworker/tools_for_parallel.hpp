@@ -53,8 +53,14 @@ void calculatePortions(
     } 
     else // no any managers
     {
+        if( nNodes < 1 ) return;
+
         SizeType main = nElems / nNodes ;
         SizeType balance = nElems % nNodes ;
+        *begCounts = std::distance( begCounts, endCounts )<=balance ? main+1 : main;
+        *begDispls = 0;
+        ++begCounts;
+        ++begDispls;
         while( begCounts != endCounts ){
             *begCounts = std::distance( begCounts, endCounts )<=balance ? main+1 : main;
             *begDispls = *(begDispls-1) + *(begCounts-1);
@@ -0,0 +1,258 @@
+#include <mpi.h>
+#include <iostream>
+#include <mutex>
+#include "../include/mpiworker/distributed_csr.hpp"
+
+#define BOOST_TEST_MODULE test_distributed_csr
+#include <boost/test/included/unit_test_framework.hpp>
+
+/*! \russian Выполняется тестирование умножения распределенной матрицы mpiworker::DistributedCSR на вектор. Для сборки только этого теста выполните команду \code make test_distributed_csr \endcode  и запустите его на исполнение, например \code mpirun -np 3 ./test_distributed_csr \endcode
+ * или в потоковом режиме \code MPIWORKER_THREADS=3 ./test_distributed_csr \endcode
+ */
+
+//! \~russian Проверки Boost.Test из потоков-узлов выполняются по очереди.
+std::mutex checkMutex;
+
+const int N = 20;
+
+//! \~russian Трехдиагональная матрица n x n; при longRange в каждой строке добавляется элемент в столбце (7i+3)%n.
+void buildMatrix( int n, bool longRange, std::vector<int> & rowPtr, std::vector<int> & cols, std::vector<double> & vals )
+{
+    rowPtr.assign( 1, 0 );
+    cols.clear();
+    vals.clear();
+
+    for( int i = 0; i < n; ++i )
+    {
+        if( i > 0 )   { cols.push_back( i - 1 ); vals.push_back( -1 ); }
+        cols.push_back( i ); vals.push_back( 2 );
+        if( i < n-1 ) { cols.push_back( i + 1 ); vals.push_back( -1 ); }
+        if( longRange ) { cols.push_back( ( 7 * i + 3 ) % n ); vals.push_back( 0.5 ); }
+        rowPtr.push_back( cols.size() );
+    }
+}
+
+//! \~russian Последовательное умножение y = A x для проверки; x[i] = i+1.
+void multiplyReference( const std::vector<int> & rowPtr, const std::vector<int> & cols, const std::vector<double> & vals,
+                        std::vector<double> & x, std::vector<double> & y )
+{
+    int n = rowPtr.size() - 1;
+
+    x.resize( n );
+    y.assign( n, 0 );
+    for( int i = 0; i < n; ++i ) x[i] = i + 1;
+    for( int i = 0; i < n; ++i )
+    {
+        for( int j = rowPtr[i]; j < rowPtr[i+1]; ++j ) y[i] += vals[j] * x[cols[j]];
+    }
+}
+
+//! \~russian Строки [first,first+nRows) матрицы в формате CSR с глобальными номерами столбцов.
+void extractRows( const std::vector<int> & rowPtr, const std::vector<int> & cols, const std::vector<double> & vals, int first, int nRows,
+                  std::vector<int> & rowPtrPerNode, std::vector<int> & colsPerNode, std::vector<double> & valsPerNode )
+{
+    rowPtrPerNode.assign( 1, 0 );
+    for( int i = first; i < first + nRows; ++i ) rowPtrPerNode.push_back( rowPtr[i+1] - rowPtr[first] );
+
+    colsPerNode.assign( cols.begin() + rowPtr[first], cols.begin() + rowPtr[first + nRows] );
+    valsPerNode.assign( vals.begin() + rowPtr[first], vals.begin() + rowPtr[first + nRows] );
+}
+
+
+BOOST_AUTO_TEST_CASE( test_distributed_csr_spmv )
+{
+    std::vector<int> rowPtr, cols;
+    std::vector<double> vals;
+    buildMatrix( N, true, rowPtr, cols, vals );
+
+    std::vector<double> x, y;
+    multiplyReference( rowPtr, cols, vals, x, y );
+
+    mpiworker::run( [&]{
+
+        mpiworker::MPIWorker w;
+
+        for( short mode = 0; mode <= 1; ++mode )
+        {
+            w.setMode( mode );
+            w.setNElems( N );
+
+            int first = w.getDisplsElemsPerNode()[w.getRankNode()];
+            int nRows = w.getNElemsPerNode();
+
+            std::vector<int> rowPtrPerNode, colsPerNode;
+            std::vector<double> valsPerNode;
+            extractRows( rowPtr, cols, vals, first, nRows, rowPtrPerNode, colsPerNode, valsPerNode );
+
+            mpiworker::DistributedCSR<double> A( w, rowPtrPerNode, colsPerNode, valsPerNode, MPI::DOUBLE );
+
+            std::vector<double> xPerNode( x.begin() + first, x.begin() + first + nRows ), yPerNode;
+
+            A.spmv( xPerNode, yPerNode );
+            A.spmv( xPerNode, yPerNode );
+
+            std::lock_guard<std::mutex> lock( checkMutex );
+            BOOST_CHECK_EQUAL_COLLECTIONS( yPerNode.begin(), yPerNode.end(), y.begin() + first, y.begin() + first + nRows );
+        }
+    } );
+}
+
+
+
+BOOST_AUTO_TEST_CASE( test_distributed_csr_spmv_large )
+{
+    mpiworker::run( []{
+
+        mpiworker::MPIWorker w;
+
+        // more than 1024 rows per node even with a manager node, so that the OpenMP path is taken under MPI
+        int n = 1100 * w.getNNodes();
+
+        std::vector<int> rowPtr, cols;
+        std::vector<double> vals, x, y;
+        buildMatrix( n, true, rowPtr, cols, vals );
+        multiplyReference( rowPtr, cols, vals, x, y );
+
+        for( short mode = 0; mode <= 1; ++mode )
+        {
+            w.setMode( mode );
+            w.setNElems( n );
+
+            int first = w.getDisplsElemsPerNode()[w.getRankNode()];
+            int nRows = w.getNElemsPerNode();
+
+            std::vector<int> rowPtrPerNode, colsPerNode;
+            std::vector<double> valsPerNode;
+            extractRows( rowPtr, cols, vals, first, nRows, rowPtrPerNode, colsPerNode, valsPerNode );
+
+            mpiworker::DistributedCSR<double> A( w, rowPtrPerNode, colsPerNode, valsPerNode, MPI::DOUBLE );
+
+            std::vector<double> xPerNode( x.begin() + first, x.begin() + first + nRows ), yPerNode;
+            A.spmv( xPerNode, yPerNode );
+
+            std::lock_guard<std::mutex> lock( checkMutex );
+            BOOST_CHECK_EQUAL_COLLECTIONS( yPerNode.begin(), yPerNode.end(), y.begin() + first, y.begin() + first + nRows );
+        }
+    } );
+}
+
+BOOST_AUTO_TEST_CASE( test_distributed_csr_exchange_plan )
+{
+    std::vector<int> rowPtr, cols;
+    std::vector<double> vals;
+    buildMatrix( N, false, rowPtr, cols, vals );
+
+    mpiworker::run( [&]{
+
+        mpiworker::MPIWorker w;
+
+        for( short mode = 0; mode <= 1; ++mode )
+        {
+            w.setMode( mode );
+            w.setNElems( N );
+
+            int first = w.getDisplsElemsPerNode()[w.getRankNode()];
+            int nRows = w.getNElemsPerNode();
+
+            std::vector<int> rowPtrPerNode, colsPerNode;
+            std::vector<double> valsPerNode;
+            extractRows( rowPtr, cols, vals, first, nRows, rowPtrPerNode, colsPerNode, valsPerNode );
+
+            mpiworker::DistributedCSR<double> A( w, rowPtrPerNode, colsPerNode, valsPerNode, MPI::DOUBLE );
+
+            // a tridiagonal matrix needs one entry from each adjacent node, nothing else
+            int expected = nRows ? ( first > 0 ) + ( first + nRows < N ) : 0;
+
+            std::lock_guard<std::mutex> lock( checkMutex );
+            BOOST_CHECK_EQUAL( A.getNGhosts(), expected );
+            BOOST_CHECK_EQUAL( A.getNNeighbours(), expected );
+        }
+    } );
+}
+
+
+
+BOOST_AUTO_TEST_CASE( test_distributed_csr_private_communicator )
+{
+    std::vector<int> rowPtr, cols;
+    std::vector<double> vals;
+    buildMatrix( N, false, rowPtr, cols, vals );
+
+    std::vector<double> x, y;
+    multiplyReference( rowPtr, cols, vals, x, y );
+
+    mpiworker::run( [&]{
+
+        mpiworker::MPIWorker w;
+        w.setMode( 1 );
+        w.setNElems( N );
+
+        if( w.getThreadComm() || w.getNNodes() < 2 ) return;
+
+        int rank = w.getRankNode();
+        int first = w.getDisplsElemsPerNode()[rank];
+        int nRows = w.getNElemsPerNode();
+
+        std::vector<int> rowPtrPerNode, colsPerNode;
+        std::vector<double> valsPerNode;
+        extractRows( rowPtr, cols, vals, first, nRows, rowPtrPerNode, colsPerNode, valsPerNode );
+
+        mpiworker::DistributedCSR<double> A( w, rowPtrPerNode, colsPerNode, valsPerNode, MPI::DOUBLE );
+
+        // an application message with tag 0 between spmv neighbours must not be mixed up with the exchange
+        double message = -1;
+        MPI::Request request;
+        if( rank == 0 ) request = MPI::COMM_WORLD.Isend( &message, 1, MPI::DOUBLE, 1, 0 );
+
+        std::vector<double> xPerNode( x.begin() + first, x.begin() + first + nRows ), yPerNode;
+        A.spmv( xPerNode, yPerNode );
+
+        double received = 0;
+        if( rank == 0 ) request.Wait();
+        if( rank == 1 ) MPI::COMM_WORLD.Recv( &received, 1, MPI::DOUBLE, 0, 0 );
+
+        BOOST_CHECK_EQUAL_COLLECTIONS( yPerNode.begin(), yPerNode.end(), y.begin() + first, y.begin() + first + nRows );
+        if( rank == 1 ) BOOST_CHECK_EQUAL( received, -1 );
+    } );
+}
+
+BOOST_AUTO_TEST_CASE( test_distributed_csr_invalid_input )
+{
+    std::vector<int> rowPtr, cols;
+    std::vector<double> vals;
+    buildMatrix( N, false, rowPtr, cols, vals );
+
+    mpiworker::run( [&]{
+
+        mpiworker::MPIWorker w;
+        w.setMode( 1 );
+        w.setNElems( N );
+
+        int first = w.getDisplsElemsPerNode()[w.getRankNode()];
+        int nRows = w.getNElemsPerNode();
+        bool last = w.getRankNode() == w.getNNodes() - 1;                 // only the last node is wrong
+
+        for( int error = 0; error < 2; ++error )
+        {
+            std::vector<int> rowPtrPerNode, colsPerNode;
+            std::vector<double> valsPerNode;
+            extractRows( rowPtr, cols, vals, first, nRows, rowPtrPerNode, colsPerNode, valsPerNode );
+
+            if( last && error == 0 ) colsPerNode.back() = N;                 // column out of range
+            if( last && error == 1 ) rowPtrPerNode[1] = colsPerNode.size() + 1;  // row pointers go backwards and past cols
+
+            bool thrown = false;
+            try
+            {
+                mpiworker::DistributedCSR<double> A( w, rowPtrPerNode, colsPerNode, valsPerNode, MPI::DOUBLE );
+            }
+            catch( const std::invalid_argument & )
+            {
+                thrown = true;
+            }
+
+            std::lock_guard<std::mutex> lock( checkMutex );
+            BOOST_CHECK( thrown );
+        }
+    } );
+}
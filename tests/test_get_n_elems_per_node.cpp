@@ -1,5 +1,6 @@
 #include <mpi.h>
 #include <iostream>
+#include <mutex>
 #include "../include/mpiworker/mpiworker.hpp"
 
 #define BOOST_TEST_MODULE test_get_n_elems_per_node
@@ -7,66 +8,61 @@
 
 #define DEBUG 0
 
+//! \~russian Проверки Boost.Test из потоков-узлов выполняются по очереди.
+std::mutex checkMutex;
+
 /*! \russian Выполняется тестирование метода getNElemsPerNode. Для сборки только этого теста выполните команду \code make make test_get_n_elems_per_node \endcode  и запустите его на исполнение, например \code mpirun -np 3 ./test_get_n_elems_per_node \endcode
+ * или в потоковом режиме \code MPIWORKER_THREADS=3 ./test_get_n_elems_per_node \endcode
  */
 BOOST_AUTO_TEST_CASE( test_get_n_elems_per_node )
 {
+  mpiworker::run( []{
+
     int N = 7;
 
     mpiworker::MPIWorker a;
 
     if( a.getNNodes() != 3 )
     {
-        std::cerr << "Run the command: mpirun -np 3 ./test_get_n_elems_per_node\n";
-        MPI::COMM_WORLD.Abort( MPI_ERR_ARG );
+        std::cerr << "Run the command: mpirun -np 3 ./test_get_n_elems_per_node or MPIWORKER_THREADS=3 ./test_get_n_elems_per_node\n";
+        throw std::invalid_argument( "test_get_n_elems_per_node needs 3 nodes" );
     }
 
     a.setMode(0);
     a.setNElems(N);
 
 #if DEBUG > 0
-    if( a.getRankNode()==0 )  a.print();   MPI::COMM_WORLD.Barrier();
-    if( a.getRankNode()==1 )  a.print();   MPI::COMM_WORLD.Barrier();
-    if( a.getRankNode()==2 )  a.print();   MPI::COMM_WORLD.Barrier();
+    for( int r = 0; r < 3; ++r ) { if( a.getRankNode()==r ) a.print(); int sync = 0; a.bcast<int>( sync, MPI::INT ); }
 #endif
-    
-    if( a.getRankNode() == 0) 
-    {
-        BOOST_CHECK( a.getNElemsPerNode() == 0 );
-    }
-
-    if( a.getRankNode() == 1) 
-    {
-        BOOST_CHECK( a.getNElemsPerNode() == 3 );
-    }
 
-    if( a.getRankNode() == 2) 
-    {
-        BOOST_CHECK( a.getNElemsPerNode() == 4 );
-    }
+    int nElemsMode0 = a.getNElemsPerNode();
 
     a.setMode(1);
 
 #if DEBUG > 0
-    if( a.getRankNode()==0 )  a.print();   MPI::COMM_WORLD.Barrier();
-    if( a.getRankNode()==1 )  a.print();   MPI::COMM_WORLD.Barrier();
-    if( a.getRankNode()==2 )  a.print();   MPI::COMM_WORLD.Barrier();
+    for( int r = 0; r < 3; ++r ) { if( a.getRankNode()==r ) a.print(); int sync = 0; a.bcast<int>( sync, MPI::INT ); }
 #endif
 
+    int nElemsMode1 = a.getNElemsPerNode();
+
+    std::lock_guard<std::mutex> lock( checkMutex );
+
     if( a.getRankNode() == 0) 
     {
-        BOOST_CHECK( a.getNElemsPerNode() == 2 );
+        BOOST_CHECK( nElemsMode0 == 0 );
+        BOOST_CHECK( nElemsMode1 == 2 );
     }
 
     if( a.getRankNode() == 1) 
     {
-        BOOST_CHECK( a.getNElemsPerNode() == 2 );
+        BOOST_CHECK( nElemsMode0 == 3 );
+        BOOST_CHECK( nElemsMode1 == 2 );
     }
 
     if( a.getRankNode() == 2) 
     {
-        BOOST_CHECK( a.getNElemsPerNode() == 3 );
+        BOOST_CHECK( nElemsMode0 == 4 );
+        BOOST_CHECK( nElemsMode1 == 3 );
     }
-
-    a.setMode(1);
+  } );
 }
@@ -6,9 +6,11 @@
 #include <boost/test/included/unit_test_framework.hpp>
 
 /*! \russian Выполняется тестирование операторов scattrv и gatherv. Для сборки только этого теста выполните команду \code make test_scatter_then_gather \endcode  и запустите его на исполнение, например \code mpirun -np 2 ./test_scatter_then_gather \endcode
+ * или в потоковом режиме \code MPIWORKER_THREADS=2 ./test_scatter_then_gather \endcode
  */
 BOOST_AUTO_TEST_CASE( test_scatter_and_gather )
 {
+  mpiworker::run( []{
 
     std::cout << "test for scatterv and gatherv\n";
 
@@ -45,4 +47,5 @@ BOOST_AUTO_TEST_CASE( test_scatter_and_gather )
     {
         BOOST_CHECK_EQUAL_COLLECTIONS(x.begin(),x.end(),y.begin(),y.end());
     }
+  } );
 }
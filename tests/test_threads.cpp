@@ -0,0 +1,90 @@
+#define MPIWORKER_NO_MPI
+#include <iostream>
+#include <numeric>
+#include "../include/mpiworker/mpiworker.hpp"
+
+#define BOOST_TEST_MODULE test_threads
+#include <boost/test/included/unit_test_framework.hpp>
+
+/*! \russian Выполняется тестирование потокового режима (mpiworker::runThreads) без библиотеки MPI: редукций, выбора разбиения нулевым узлом и обработки исключений.
+ * Остальные тесты запускаются в потоковом режиме через переменную окружения, например \code MPIWORKER_THREADS=3 ./test_scatter_then_gather \endcode
+ * Для сборки только этого теста выполните команду \code make test_threads \endcode  и запустите его на исполнение \code ./test_threads \endcode
+ */
+BOOST_AUTO_TEST_CASE( test_threads_reduce )
+{
+    const int nNodes = 3;
+    const int N = 11;
+
+    std::vector< std::vector<int> > reduced( nNodes ), allReduced( nNodes ), allReducedMax( nNodes );
+
+    mpiworker::runThreads
+    (
+        nNodes,
+        [&]
+        {
+            mpiworker::MPIWorker w;
+            int rank = w.getRankNode();
+
+            w.setMode( 1 );
+            w.setNElems( N );
+
+            std::vector<int> part( N, rank + 1 );
+            w.reduce<int>( part, reduced[rank], MPI::INT, MPI::SUM );
+            w.allReduce<int>( part, allReduced[rank], MPI::INT, MPI::SUM );
+            w.allReduce<int>( part, allReducedMax[rank], MPI::INT, MPI::MAX );
+        }
+    );
+
+    BOOST_CHECK( reduced[0] == std::vector<int>( N, 6 ) );
+
+    for( int r = 0; r < nNodes; ++r )
+    {
+        BOOST_CHECK( allReduced[r] == std::vector<int>( N, 6 ) );
+        BOOST_CHECK( allReducedMax[r] == std::vector<int>( N, 3 ) );
+    }
+}
+
+
+BOOST_AUTO_TEST_CASE( test_threads_layout_from_zero_node )
+{
+    std::vector<int> nElemsPerNode( 3 );
+
+    mpiworker::runThreads
+    (
+        3,
+        [&]
+        {
+            mpiworker::MPIWorker w;
+            int rank = w.getRankNode();
+
+            w.setMode( rank ? 0 : 1 );                   // values of the zero node win
+            w.setNElems( rank ? 100 : 7 );
+            nElemsPerNode[rank] = w.getNElemsPerNode();
+        }
+    );
+
+    BOOST_CHECK( nElemsPerNode == std::vector<int>( { 2, 2, 3 } ) );
+}
+
+
+BOOST_AUTO_TEST_CASE( test_threads_exception )
+{
+    BOOST_CHECK_THROW
+    (
+        mpiworker::runThreads
+        (
+            3,
+            []
+            {
+                mpiworker::MPIWorker w;
+                if( w.getRankNode() == 1 ) throw std::runtime_error( "node 1 failed" );
+                int n = 0;
+                w.bcast<int>( n, MPI::INT );
+            }
+        ),
+        std::runtime_error
+    );
+
+    BOOST_CHECK_THROW( mpiworker::MPIWorker w, std::logic_error );
+}
+